@@ -0,0 +1,44 @@
+#ifndef GATE_ACCUMULATOR_H
+#define GATE_ACCUMULATOR_H
+
+#include <string>
+#include "TH2.h"
+
+/************************************************************//**
+ * Energy-angle accumulator for a single sum energy gate
+ *
+ * For a sum gate at E the gamma_1 energy can never exceed
+ * E + threshold, so the matrix is only allocated up to that
+ * energy. Weighted accumulators also carry the sum of squared
+ * weights. Storage is created on the first fill and expanded back
+ * to the standard angle x energy layout when written.
+ ***************************************************************/
+class GateAccumulator
+{
+public:
+	GateAccumulator(std::string name, std::string title, float gate, float threshold, int angle_bins, int g_bins, int g_min, int g_max, bool weighted = false);
+	~GateAccumulator();
+
+	void Fill(double angle_index, double energy, double weight = 1.);
+	TH2D *Expand() const;
+
+	bool IsAllocated() const {return fHist != NULL;}
+	long ClippedBytes() const;
+	long FullBytes() const;
+
+private:
+	void Allocate();
+
+	std::string fName;
+	std::string fTitle;
+	int fAngleBins;
+	int fGBins;
+	int fGMin;
+	int fGMax;
+	int fClippedBins; // energy bins up to gate + threshold
+	bool fWeighted;
+
+	TH2D *fHist = NULL;
+};
+
+#endif
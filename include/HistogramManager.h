@@ -7,33 +7,41 @@
 #include "TGriffinBgo.h"
 #include "TChain.h"
 #include "TVector3.h"
+#include "GateAccumulator.h"
 
 class HistogramManager
 {
 public:
-    void MakeHistogramFile(TChain *inputChain, std::string linearParamFile);
+    int MakeHistogramFile(TChain *inputChain, std::string linearParamFile, bool tunedRead = false);
     void InitializeHistograms(int verbose = 0);
-    void FillHistograms(TChain *gChain);
+    int FillHistograms(TChain *gChain, bool tunedRead = false);
 
 private:
     void PreProcessData();
+    bool PruneBranches(TTree *tree);
+    void EnableBranches(TObjArray *branches);
+    long long GetEnabledZipBytes(TBranch *branch);
+    void CacheEnabledBranches(TChain *gChain, TBranch *branch);
+    void ConfigureTreeCache(TChain *gChain);
     void WriteHistogramsToFile();
     bool EnergyGate(float gate, float hit_1_energy, float hit_2_energy, float threshold);
     int GetAngleIndex(double angle, std::vector<double> vec);
     int GetClosest(int val_1, int val_2, std::vector<double> vec, double target);
     void DisplayLoadingMessage();
+    void PrintMemoryReport();
 
     TGriffin *fGrif = NULL;
     TGriffinBgo *fGriffinBgo = NULL;
 
     int num_crystals = 64;
+    float gate_threshold = 3; // bounds of energy gate (-+ 3)
 
     double offsets[64];
     double gains[64];
 
     std::vector<TH1D*> hist_vec_1D;
-    std::vector<TH2D*> hist_vec_2D;
-    std::vector<TH2D*> hist_vec_2D_mixed;
+    std::vector<GateAccumulator*> hist_vec_2D;
+    std::vector<GateAccumulator*> hist_vec_2D_mixed;
 
     std::vector<float> energy_vec; // vector which contains the energy values
     std::vector<long> time_vec; // vector which contains the time values
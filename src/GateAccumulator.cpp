@@ -0,0 +1,128 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Gate-aware energy-angle accumulator
+//
+// Creation Date:   Sunday October 18, 2026
+// Last Update:     Sunday October 18, 2026
+// Usage:
+//
+//////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include "TH1.h"
+#include "GateAccumulator.h"
+
+/************************************************************//**
+ * Constructor, no storage is allocated until the first fill
+ *
+ * @param name Name of the expanded histogram
+ * @param title Title of the expanded histogram
+ * @param gate Energy of interest (keV)
+ * @param threshold Accepted energy difference from gate (keV)
+ * @param angle_bins Number of angular bins
+ * @param g_bins Number of energy bins in the full layout
+ * @param g_min Lower energy edge (keV)
+ * @param g_max Upper energy edge (keV)
+ * @param weighted Accumulator takes weighted fills (stores Sumw2)
+ ***************************************************************/
+GateAccumulator::GateAccumulator(std::string name, std::string title, float gate, float threshold, int angle_bins, int g_bins, int g_min, int g_max, bool weighted)
+	: fName(name), fTitle(title), fAngleBins(angle_bins), fGBins(g_bins), fGMin(g_min), fGMax(g_max), fWeighted(weighted)
+{
+	double bin_width = (double)(g_max - g_min) / g_bins;
+	fClippedBins = (int)std::ceil((gate + threshold - g_min) / bin_width);
+	if (fClippedBins < 1) fClippedBins = 1;
+	if (fClippedBins > fGBins) fClippedBins = fGBins;
+} // GateAccumulator
+
+GateAccumulator::~GateAccumulator()
+{
+	delete fHist;
+} // ~GateAccumulator
+
+/************************************************************//**
+ * Fills the accumulator, allocating on first use
+ *
+ * @param angle_index Angular bin index
+ * @param energy Energy of gamma 1 (keV)
+ * @param weight Fill weight
+ ***************************************************************/
+void GateAccumulator::Fill(double angle_index, double energy, double weight)
+{
+	if (fHist == NULL) Allocate();
+
+	// a hit above the clipped range (e.g. negative partner energy)
+	// promotes the accumulator to the full layout so no counts are lost
+	if (fClippedBins < fGBins && energy >= fHist->GetYaxis()->GetXmax()) {
+		TH2D *clipped = fHist;
+		fClippedBins = fGBins;
+		fHist = Expand();
+		fHist->SetDirectory(0);
+		delete clipped;
+	}
+
+	fHist->Fill(angle_index, energy, weight);
+} // Fill
+
+/************************************************************//**
+ * Allocates the clipped matrix
+ *
+ ***************************************************************/
+void GateAccumulator::Allocate()
+{
+	double bin_width = (double)(fGMax - fGMin) / fGBins;
+	fHist = new TH2D(Form("%s_clipped", fName.c_str()), fTitle.c_str(), fAngleBins, 0, fAngleBins, fClippedBins, fGMin, fGMin + fClippedBins * bin_width);
+	fHist->SetDirectory(0);
+	if (fWeighted) fHist->Sumw2();
+} // Allocate
+
+/************************************************************//**
+ * Builds the standard angle x energy histogram from the
+ * accumulated data. The caller owns the returned histogram.
+ *
+ ***************************************************************/
+TH2D *GateAccumulator::Expand() const
+{
+	TH2D *full = new TH2D(fName.c_str(), fTitle.c_str(), fAngleBins, 0, fAngleBins, fGBins, fGMin, fGMax);
+	if (fHist == NULL) return full;
+
+	bool has_sumw2 = fHist->GetSumw2N() > 0;
+	if (has_sumw2) full->Sumw2();
+
+	int clipped_bins = fHist->GetNbinsY();
+	for (int ix = 0; ix <= fAngleBins + 1; ++ix) {
+		// underflow and every clipped bin map one to one onto the full layout
+		for (int iy = 0; iy <= clipped_bins; ++iy) {
+			full->SetBinContent(ix, iy, fHist->GetBinContent(ix, iy));
+			if (has_sumw2) full->SetBinError(ix, iy, fHist->GetBinError(ix, iy));
+		}
+		if (clipped_bins == fGBins) {
+			full->SetBinContent(ix, fGBins + 1, fHist->GetBinContent(ix, fGBins + 1));
+			if (has_sumw2) full->SetBinError(ix, fGBins + 1, fHist->GetBinError(ix, fGBins + 1));
+		}
+	}
+
+	double stats[TH1::kNstat];
+	fHist->GetStats(stats);
+	full->PutStats(stats);
+	full->SetEntries(fHist->GetEntries());
+
+	return full;
+} // Expand
+
+/************************************************************//**
+ * Bytes needed for the clipped bin contents (and Sumw2)
+ *
+ ***************************************************************/
+long GateAccumulator::ClippedBytes() const
+{
+	long arrays = fWeighted ? 2 : 1;
+	return arrays * (fAngleBins + 2) * (fClippedBins + 2) * sizeof(double);
+} // ClippedBytes
+
+/************************************************************//**
+ * Bytes needed for the bin contents (and Sumw2) of the full layout
+ *
+ ***************************************************************/
+long GateAccumulator::FullBytes() const
+{
+	long arrays = fWeighted ? 2 : 1;
+	return arrays * (fAngleBins + 2) * (fGBins + 2) * sizeof(double);
+} // FullBytes
@@ -9,6 +9,8 @@
 //////////////////////////////////////////////////////////////////////////////////
 #include <iostream>
 #include <fstream>
+#include "TFile.h"
+#include "TChainElement.h"
 #include "HistogramManager.h"
 #include "progress_bar.h"
 #include "globals.h"
@@ -18,9 +20,13 @@ std::vector<float> energy_gates_vec = {700, 1022, 1460, 1760, 2614};
 /************************************************************//**
  * Creates and Fills histograms
  *
- * @param verbose Verbosity level
+ * @param inputChain Data chain
+ * @param linearParamFile Secondary linear calibration file
+ * @param tunedRead Prune unused branches and tune the tree cache
+ *
+ * @return 0 on success, 1 if the data could not be read
  ***************************************************************/
-void HistogramManager::MakeHistogramFile(TChain *inputChain, std::string linearParamFile)
+int HistogramManager::MakeHistogramFile(TChain *inputChain, std::string linearParamFile, bool tunedRead)
 {
 	int verbose = 0;
 
@@ -43,10 +49,14 @@ void HistogramManager::MakeHistogramFile(TChain *inputChain, std::string linearP
 	if (verbose > 0) {std::cout << "Generating Post-Calibrated Histograms ..." << std::endl;}
 
 	InitializeHistograms();
-	FillHistograms(inputChain);
+	if (FillHistograms(inputChain, tunedRead) != 0) {
+		return 1;
+	}
 	WriteHistogramsToFile();
 
 	if (verbose > 0) {std::cout << "Generating Post-Calibrated Histograms ... [DONE]" << std::endl;}
+
+	return 0;
 } // GenerateHistogramFile
 
 /************************************************************//**
@@ -69,9 +79,10 @@ void HistogramManager::InitializeHistograms(int verbose)
 
 	// 2D Histograms
 	for (auto const &energy_gate : energy_gates_vec) {
-    	hist_vec_2D.push_back(new TH2D(Form("energy_angle_%i", (int)energy_gate), Form("#gamma_1 Energy Angle %i keV;Angle; #gamma Energy (keV)", (int)energy_gate), angle_bins, 0, angle_bins, g_bins, g_min, g_max));
-    	hist_vec_2D_mixed.push_back(new TH2D(Form("energy_angle_%i_mixed", (int)energy_gate), Form("#gamma_1 Energy Angle %i keV Mixed;Angle; #gamma Energy (keV)", (int)energy_gate), angle_bins, 0, angle_bins, g_bins, g_min, g_max));
+    	hist_vec_2D.push_back(new GateAccumulator(Form("energy_angle_%i", (int)energy_gate), Form("#gamma_1 Energy Angle %i keV;Angle; #gamma Energy (keV)", (int)energy_gate), energy_gate, gate_threshold, angle_bins, g_bins, g_min, g_max, true));
+    	hist_vec_2D_mixed.push_back(new GateAccumulator(Form("energy_angle_%i_mixed", (int)energy_gate), Form("#gamma_1 Energy Angle %i keV Mixed;Angle; #gamma Energy (keV)", (int)energy_gate), energy_gate, gate_threshold, angle_bins, g_bins, g_min, g_max));
 	}
+	PrintMemoryReport();
 	//hist_vec_2D.push_back(new TH2D("AB_AngDiff_Supp_1022", "#gamma_1 Energy Angle;Angle; #gamma Energy (keV)", angle_bins, 0, angle_bins, g_bins, g_min, g_max));
 	//hist_vec_2D.push_back(new TH2D("AB_AngDiff_Supp_1022_mixed", "#gamma_1 Energy Angle (Mixed);Angle; #gamma Energy (keV)", angle_bins, 0, angle_bins, g_bins, g_min, g_max));
 
@@ -83,14 +94,16 @@ void HistogramManager::InitializeHistograms(int verbose)
  * Fills histograms
  *
  * @param gChain Data chain
+ * @param tunedRead Prune unused branches and tune the tree cache
+ *
+ * @return 0 on success, 1 if a file in the chain could not be read
  ***************************************************************/
-void HistogramManager::FillHistograms(TChain *gChain)
+int HistogramManager::FillHistograms(TChain *gChain, bool tunedRead)
 {
 
 	float ggPrompt = 30.; // max time difference for gamma gamma; 30 ns
 	float bgLow = 500.; // min time difference for gamma gamma time random
 	float bgHigh = 2000.; // max time diff for gamma gamma time random
-	float gate_threshold = 3; // bounds of energy gate (-+ 3)
 
 	if (gChain->FindBranch("TGriffin")) {
 		gChain->SetBranchAddress("TGriffin", &fGrif);
@@ -105,12 +118,52 @@ void HistogramManager::FillHistograms(TChain *gChain)
 
 	long analysis_entries = gChain->GetEntries();
 
+	// I/O bookkeeping for the tuned read mode
+	int tree_number = -1;
+	long long next_tree_entry = 0;
+	long long bytes_read_start = TFile::GetFileBytesRead();
+	long long bytes_read_file = bytes_read_start;
+	long long file_size = 0;
+	long long total_file_size = 0;
+	std::string file_name;
+
 	/* Creates a progress bar that has a width of 70,
 	 * shows '=' to indicate completion, and blank
 	 * space for incomplete
 	 */
 	ProgressBar progress_bar(analysis_entries, 70, '=', ' ');
 	for (auto i = 0; i < analysis_entries; i++) {
+		// report the previous file before the next one is opened
+		if (tunedRead && i >= next_tree_entry) {
+			if (tree_number >= 0) {
+				std::cout << std::endl << "Read " << (TFile::GetFileBytesRead() - bytes_read_file) / (1024. * 1024.) << " MB of "
+				          << file_size / (1024. * 1024.) << " MB from " << file_name << std::endl;
+			}
+			bytes_read_file = TFile::GetFileBytesRead();
+
+			long long load_status = gChain->LoadTree(i);
+			if (load_status < 0) {
+				// offsets are filled by GetEntries, so the failing file can be named
+				int bad_tree = 0;
+				while (bad_tree < gChain->GetNtrees() - 1 && gChain->GetTreeOffset()[bad_tree + 1] <= i) ++bad_tree;
+				TChainElement *element = (TChainElement*)gChain->GetListOfFiles()->At(bad_tree);
+				std::cerr << std::endl << "Failed to load entry " << i << " from "
+				          << (element != NULL ? element->GetTitle() : "unknown file")
+				          << " (LoadTree returned " << load_status << ")" << std::endl;
+				return 1;
+			}
+			tree_number = gChain->GetTreeNumber();
+			next_tree_entry = gChain->GetChainOffset() + gChain->GetTree()->GetEntries();
+			file_name = gChain->GetCurrentFile()->GetName();
+			file_size = gChain->GetCurrentFile()->GetSize();
+			total_file_size += file_size;
+
+			if (!PruneBranches(gChain->GetTree())) {
+				std::cerr << std::endl << "No TGriffin branch in " << file_name << " ... exiting" << std::endl;
+				return 1;
+			}
+			ConfigureTreeCache(gChain);
+		}
 		gChain->GetEntry(i);
 
 		// Applies secondary energy calculation
@@ -219,8 +272,129 @@ void HistogramManager::FillHistograms(TChain *gChain)
 	} // end TChain loop
 
 	progress_bar.done();
+
+	if (tunedRead) {
+		std::cout << "Read " << (TFile::GetFileBytesRead() - bytes_read_file) / (1024. * 1024.) << " MB of "
+		          << file_size / (1024. * 1024.) << " MB from " << file_name << std::endl;
+		std::cout << "Total read: " << (TFile::GetFileBytesRead() - bytes_read_start) / (1024. * 1024.) << " MB of "
+		          << total_file_size / (1024. * 1024.) << " MB on disk" << std::endl;
+	}
+
+	return 0;
 } // FillHistograms
 
+/************************************************************//**
+ * Disables every branch of the loaded tree except the ones
+ * PreProcessData reads. Split sub-branches are enabled through
+ * the branch objects, since their names need not carry a
+ * TGriffin prefix.
+ *
+ * @param tree Tree of the file just loaded
+ *
+ * @return false if the tree has no TGriffin branch
+ ***************************************************************/
+bool HistogramManager::PruneBranches(TTree *tree)
+{
+	tree->SetBranchStatus("*", 0);
+
+	TBranch *branch = tree->GetBranch("TGriffin");
+	if (branch == NULL) return false;
+
+	branch->ResetBit(TBranch::kDoNotProcess);
+	EnableBranches(branch->GetListOfBranches());
+
+	return true;
+} // PruneBranches
+
+/************************************************************//**
+ * Recursively enables sub-branches, leaving waveforms disabled
+ *
+ * @param branches List of sub-branches
+ ***************************************************************/
+void HistogramManager::EnableBranches(TObjArray *branches)
+{
+	for (int i = 0; i < branches->GetEntriesFast(); ++i) {
+		TBranch *branch = (TBranch*)branches->At(i);
+		if (branch == NULL) continue;
+
+		// waveforms are never used
+		if (std::string(branch->GetName()).find("fWaveform") != std::string::npos) continue;
+
+		branch->ResetBit(TBranch::kDoNotProcess);
+		EnableBranches(branch->GetListOfBranches());
+	}
+} // EnableBranches
+
+/************************************************************//**
+ * Compressed size of a branch and its enabled sub-branches
+ *
+ * @param branch Branch to sum
+ ***************************************************************/
+long long HistogramManager::GetEnabledZipBytes(TBranch *branch)
+{
+	if (branch->TestBit(TBranch::kDoNotProcess)) return 0;
+
+	long long zip_bytes = branch->GetZipBytes();
+	TObjArray *branches = branch->GetListOfBranches();
+	for (int i = 0; i < branches->GetEntriesFast(); ++i) {
+		TBranch *sub_branch = (TBranch*)branches->At(i);
+		if (sub_branch != NULL) zip_bytes += GetEnabledZipBytes(sub_branch);
+	}
+
+	return zip_bytes;
+} // GetEnabledZipBytes
+
+/************************************************************//**
+ * Adds a branch and its enabled sub-branches to the tree cache
+ *
+ * @param gChain Data chain
+ * @param branch Branch to cache
+ ***************************************************************/
+void HistogramManager::CacheEnabledBranches(TChain *gChain, TBranch *branch)
+{
+	if (branch->TestBit(TBranch::kDoNotProcess)) return;
+
+	gChain->AddBranchToCache(branch, false);
+	TObjArray *branches = branch->GetListOfBranches();
+	for (int i = 0; i < branches->GetEntriesFast(); ++i) {
+		TBranch *sub_branch = (TBranch*)branches->At(i);
+		if (sub_branch != NULL) CacheEnabledBranches(gChain, sub_branch);
+	}
+} // CacheEnabledBranches
+
+/************************************************************//**
+ * Sizes the tree cache and enables cluster prefetching for the
+ * file just loaded, skipping the learning phase since the
+ * branches to cache are known
+ *
+ * @param gChain Data chain
+ ***************************************************************/
+void HistogramManager::ConfigureTreeCache(TChain *gChain)
+{
+	long long min_cache = 10 * 1024 * 1024; // 10 MB
+	long long max_cache = 200 * 1024 * 1024; // 200 MB
+
+	// enough to hold two clusters of the enabled TGriffin branches
+	TTree *tree = gChain->GetTree();
+	TBranch *branch = tree->GetBranch("TGriffin");
+	long long entries = tree->GetEntries();
+	long long zip_bytes = (branch != NULL) ? GetEnabledZipBytes(branch) : tree->GetZipBytes();
+
+	// size of the first cluster, independent of how auto-flush was set
+	TTree::TClusterIterator cluster_iter = tree->GetClusterIterator(0);
+	long long cluster_start = cluster_iter.Next();
+	long long cluster_entries = cluster_iter.GetNextEntry() - cluster_start;
+	if (cluster_entries <= 0 || cluster_entries > entries) cluster_entries = entries;
+	long long cache_size = (entries > 0) ? 2 * zip_bytes / entries * cluster_entries : min_cache;
+	if (cache_size < min_cache) cache_size = min_cache;
+	if (cache_size > max_cache) cache_size = max_cache;
+
+	gChain->SetClusterPrefetch(true);
+	gChain->SetCacheSize(cache_size);
+	if (branch != NULL) CacheEnabledBranches(gChain, branch);
+	gChain->StopCacheLearningPhase();
+} // ConfigureTreeCache
+
 /************************************************************//**
  * Applies linear calibration to data points
  *
@@ -285,18 +459,50 @@ void HistogramManager::WriteHistogramsToFile()
 	for (auto const &h : hist_vec_1D) {
 		h->Write();
 	}
+	// expand the clipped accumulators back to the standard layout one at a time
 	for (auto const &h : hist_vec_2D) {
-		h->Write();
+		TH2D *full = h->Expand();
+		full->Write();
+		delete full;
+		delete h;
 	}
+	hist_vec_2D.clear();
 	for (auto const &h : hist_vec_2D_mixed) {
-		h->Write();
+		TH2D *full = h->Expand();
+		full->Write();
+		delete full;
+		delete h;
 	}
+	hist_vec_2D_mixed.clear();
 	out_file->Close();
 	delete out_file;
 
 } // WriteHistogramsToFile
 
 
+/************************************************************//**
+ * Prints the memory needed by the gated matrices compared to
+ * the full angle x energy layout
+ *
+ ***************************************************************/
+void HistogramManager::PrintMemoryReport()
+{
+	long clipped_bytes = 0;
+	long full_bytes = 0;
+	for (auto const &h : hist_vec_2D) {
+		clipped_bytes += h->ClippedBytes();
+		full_bytes += h->FullBytes();
+	}
+	for (auto const &h : hist_vec_2D_mixed) {
+		clipped_bytes += h->ClippedBytes();
+		full_bytes += h->FullBytes();
+	}
+
+	std::cout << "Gated matrices: " << hist_vec_2D.size() + hist_vec_2D_mixed.size() << " (allocated on first fill)" << std::endl;
+	std::cout << "  Clipped layout: " << clipped_bytes / (1024. * 1024.) << " MB" << std::endl;
+	std::cout << "  Full layout:    " << full_bytes / (1024. * 1024.) << " MB" << std::endl;
+} // PrintMemoryReport
+
 /************************************************************//**
  * Returns the angular index
  *
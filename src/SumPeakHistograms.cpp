@@ -74,9 +74,7 @@ int ProcessData(){
 	std::cout << "Processing run " << run_number << " with " << gChain->GetNtrees() << " file(s)" << std::endl;
 
     HistogramManager histo_man;
-    histo_man.MakeHistogramFile(gChain, lin_coeff_file);
-
-	return 0;
+    return histo_man.MakeHistogramFile(gChain, lin_coeff_file, tuned_read);
 } // ProcessData
 
 /******************************************************************************
@@ -84,6 +82,12 @@ int ProcessData(){
  *
  *****************************************************************************/
 void AutoFileDetect(std::string fileName){
+	if (fileName == "--tuned-read") {
+		tuned_read = true;
+		std::cout << "Using tuned read mode" << std::endl;
+		return;
+	}
+
 	size_t dot_pos = fileName.find_last_of('.');
 	std::string ext = fileName.substr(dot_pos + 1);
 
@@ -126,7 +130,8 @@ void OpenRootFile(std::string fileName){
 void PrintUsage(char* argv[]){
 	std::cerr << argv[0] << " Version: " << SumPeakHistograms_VERSION_MAJOR
 	          << "." << SumPeakHistograms_VERSION_MINOR << "\n"
-	          << "usage: " << argv[0] << " calibration_file analysis_tree [analysis_tree_2 ... ] linear_parameter_file\n"
+	          << "usage: " << argv[0] << " [--tuned-read] calibration_file analysis_tree [analysis_tree_2 ... ] linear_parameter_file\n"
+	          << " --tuned-read:           only read the TGriffin branch with a tuned tree cache\n"
 	          << " calibration_file:       calibration file (must end with .cal)\n"
 	          << " analysis_tree:          analysis tree to process (must end with .root)\n"
 	          << " linear_parameter_file:  contains secondary linear parameters (must end with .txt)"